@@ -1,5 +1,8 @@
 // BMP-related data types based on Microsoft's own
 
+#ifndef BMP_H
+#define BMP_H
+
 #include <stdint.h>
 
 /**
@@ -73,3 +76,5 @@ typedef struct
     BYTE  rgbtRed;
 } __attribute__((__packed__))
 RGBTRIPLE;
+
+#endif
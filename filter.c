@@ -1,9 +1,14 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
-#include "C:\Users\lenovo\Desktop\github repo\filter-more\helpers.h"
+#include "helpers.h"
+#include "histogram.h"
+#include "rotate.h"
+#include "sequence.h"
+#include "stream.h"
 
 // Convert image to grayscale
 void grayscale(int height, int width, RGBTRIPLE image[height][width]);
@@ -14,14 +19,20 @@ void reflect(int height, int width, RGBTRIPLE image[height][width]);
 // Detect edges
 void edges(int height, int width, RGBTRIPLE image[height][width]);
 
+// Detect edges, holding the changed image in temp_image
+void edges_buffered(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE temp_image[height][width]);
+
 // Blur image
 void blur(int height, int width, RGBTRIPLE image[height][width]);
 
+// Blur image, holding the changed image in temp_image
+void blur_buffered(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE temp_image[height][width]);
+
 
 int main(int argc, char *argv[])
 {
     // Define allowable filters
-    char *filters = "begr";
+    char *filters = "abcdefghm:nrstu";
 
     // Get filter flag and check validity
     char filter = getopt(argc, argv, filters);
@@ -31,6 +42,18 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // Temporal median takes its window, in frames
+    int window = 1;
+    if (filter == 'm')
+    {
+        window = atoi(optarg);
+        if (window < 1 || window > SEQUENCE_MAX_WINDOW)
+        {
+            printf("Median window must be 1 to %i frames.\n", SEQUENCE_MAX_WINDOW);
+            return 1;
+        }
+    }
+
     // Ensure only one filter
     if (getopt(argc, argv, filters) != -1)
     {
@@ -49,6 +72,19 @@ int main(int argc, char *argv[])
     char *infile = argv[optind];
     char *outfile = argv[optind + 1];
 
+    // Numbered frames (e.g. frame_%05d.bmp) are filtered as a sequence
+    if (is_pattern(infile))
+    {
+        return filter_sequence(infile, outfile, filter, window);
+    }
+
+    // Temporal filters need a sequence
+    if (strchr("dfm", filter) != NULL)
+    {
+        printf("Temporal filters need a frame pattern, like frame_%%05d.bmp.\n");
+        return 3;
+    }
+
     // Open input file
     FILE *inptr = fopen(infile, "r");
     if (inptr == NULL)
@@ -84,6 +120,25 @@ int main(int argc, char *argv[])
         return 6;
     }
 
+    // Rotations change the image's shape, so they write outfile themselves
+    if (strchr("actu", filter) != NULL)
+    {
+        int status = rotate_file(inptr, outptr, bf, bi, rotation_for(filter, bi.biHeight));
+        fclose(inptr);
+        fclose(outptr);
+        return status;
+    }
+
+    // Histogram filters rescan a mapped infile rather than decode one that exceeds the memory budget
+    if (strchr("hns", filter) != NULL &&
+        (size_t) abs(bi.biHeight) * bi.biWidth * sizeof(RGBTRIPLE) > memory_budget())
+    {
+        int status = histogram_file(inptr, outptr, bf, bi, filter);
+        fclose(inptr);
+        fclose(outptr);
+        return status;
+    }
+
     // Get image's dimensions
     int height = abs(bi.biHeight);
     int width = bi.biWidth;
@@ -129,10 +184,25 @@ int main(int argc, char *argv[])
             grayscale(height, width, image);
             break;
 
+        // Equalize
+        case 'h':
+            equalize(height, width, image);
+            break;
+
+        // Auto-levels
+        case 'n':
+            autolevels(height, width, image);
+            break;
+
         // Reflect
         case 'r':
             reflect(height, width, image);
             break;
+
+        // Stats
+        case 's':
+            stats(height, width, image);
+            break;
     }
 
     // Write outfile's BITMAPFILEHEADER
@@ -199,6 +269,12 @@ void blur(int height, int width, RGBTRIPLE image[height][width])
     //set up a temp file to hold the changed image
     RGBTRIPLE temp_image[height][width];
 
+    blur_buffered(height, width, image, temp_image);
+}
+
+// Blur image, holding the changed image in temp_image
+void blur_buffered(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE temp_image[height][width])
+{
 
     int avg_red;
     int avg_green;
@@ -323,6 +399,12 @@ void edges(int height, int width, RGBTRIPLE image[height][width])
     //make a temp copy of image so original one is not changed untill all the pixels have been changed
     RGBTRIPLE temp_image[height][width];
 
+    edges_buffered(height, width, image, temp_image);
+}
+
+// Detect edges, holding the changed image in temp_image
+void edges_buffered(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE temp_image[height][width])
+{
     //initialize the Gx and Gy values
     int gx_red, gx_green, gx_blue, gy_red, gy_green, gy_blue;
     int gx[3][3] =
@@ -1,4 +1,4 @@
-#include "C:\Users\lenovo\Desktop\github repo\filter-more\helpers.h"
+#include "helpers.h"
 #include <stdio.h>
 #include <math.h>
 
@@ -38,6 +38,12 @@ void blur(int height, int width, RGBTRIPLE image[height][width])
     //set up a temp file to hold the changed image
     RGBTRIPLE temp_image[height][width];
 
+    blur_buffered(height, width, image, temp_image);
+}
+
+// Blur image, holding the changed image in temp_image
+void blur_buffered(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE temp_image[height][width])
+{
 
     int avg_red;
     int avg_green;
@@ -162,6 +168,12 @@ void edges(int height, int width, RGBTRIPLE image[height][width])
     //make a temp copy of image so original one is not changed untill all the pixels have been changed
     RGBTRIPLE temp_image[height][width];
 
+    edges_buffered(height, width, image, temp_image);
+}
+
+// Detect edges, holding the changed image in temp_image
+void edges_buffered(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE temp_image[height][width])
+{
     //initialize the Gx and Gy values
     int gx_red, gx_green, gx_blue, gy_red, gy_green, gy_blue;
     int gx[3][3] =
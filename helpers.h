@@ -1,4 +1,4 @@
-#include "C:\Users\lenovo\Desktop\github repo\filter-more\bmp.h"
+#include "bmp.h"
 
 // Convert image to grayscale
 void grayscale(int height, int width, RGBTRIPLE image[height][width]);
@@ -9,6 +9,12 @@ void reflect(int height, int width, RGBTRIPLE image[height][width]);
 // Detect edges
 void edges(int height, int width, RGBTRIPLE image[height][width]);
 
+// Detect edges, holding the changed image in temp_image
+void edges_buffered(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE temp_image[height][width]);
+
 // Blur image
 void blur(int height, int width, RGBTRIPLE image[height][width]);
 
+// Blur image, holding the changed image in temp_image
+void blur_buffered(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE temp_image[height][width]);
+
@@ -0,0 +1,427 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "histogram.h"
+#include "stream.h"
+
+/**
+ * HISTOGRAMSLICE
+ *
+ * One thread's share of a histogram pass: rows [first, last), counted into
+ * bins private to the thread until it finishes.
+ */
+typedef struct
+{
+    const BYTE  *pixels;
+    size_t       stride;
+    int          first;
+    int          last;
+    int          width;
+    int          release;
+    HISTOGRAM    hist;
+}
+HISTOGRAMSLICE;
+
+// Rec. 601 luminance of a pixel, 0 to 255
+static int luma(RGBTRIPLE pixel)
+{
+    return (77 * pixel.rgbtRed + 150 * pixel.rgbtGreen + 29 * pixel.rgbtBlue + 128) >> 8;
+}
+
+// Count one slice's rows
+static void *count_slice(void *arg)
+{
+    HISTOGRAMSLICE *slice = arg;
+
+    // Counting into the shared slot would bounce its cache lines between threads, so count on the stack
+    HISTOGRAM hist;
+    memset(&hist, 0, sizeof(hist));
+
+    for (int i = slice->first; i < slice->last; i++)
+    {
+        const RGBTRIPLE *row = (const RGBTRIPLE *)(slice->pixels + (size_t) i * slice->stride);
+
+        for (int j = 0; j < slice->width; j++)
+        {
+            hist.blue[row[j].rgbtBlue]++;
+            hist.green[row[j].rgbtGreen]++;
+            hist.red[row[j].rgbtRed]++;
+            hist.luma[luma(row[j])]++;
+        }
+
+        // Keep a mapped image's resident rows bounded
+        if (slice->release && ((i + 1 - slice->first) % RELEASE_ROWS == 0 || i + 1 == slice->last))
+        {
+            int done = (i - slice->first) % RELEASE_ROWS + 1;
+            release_range(slice->pixels + (size_t)(i + 1 - done) * slice->stride, (size_t) done * slice->stride);
+        }
+    }
+    hist.count = (uint64_t)(slice->last - slice->first) * slice->width;
+
+    slice->hist = hist;
+    return NULL;
+}
+
+// Count the pixels of a height x width image whose scanlines are stride bytes apart, dropping scanned
+// rows from memory if release is set (only safe for mapped images)
+void histogram(const BYTE *pixels, size_t stride, int height, int width, int release, HISTOGRAM *hist)
+{
+    // One thread per processor, but none with too few rows to pay for starting it
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > HISTOGRAM_THREADS)
+    {
+        threads = HISTOGRAM_THREADS;
+    }
+    if (threads > height / HISTOGRAM_ROWS)
+    {
+        threads = height / HISTOGRAM_ROWS;
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+
+    HISTOGRAMSLICE slices[threads];
+    pthread_t ids[threads];
+    int started[threads];
+    for (int t = 0; t < threads; t++)
+    {
+        slices[t] = (HISTOGRAMSLICE)
+        {
+            .pixels = pixels, .stride = stride, .width = width, .release = release,
+            .first = (int)((long long) height * t / threads),
+            .last = (int)((long long) height * (t + 1) / threads)
+        };
+
+        // The calling thread takes the first slice, and any a thread couldn't be started for
+        started[t] = t > 0 && pthread_create(&ids[t], NULL, count_slice, &slices[t]) == 0;
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        if (!started[t])
+        {
+            count_slice(&slices[t]);
+        }
+    }
+
+    // Merge the private bins
+    memset(hist, 0, sizeof(HISTOGRAM));
+    for (int t = 0; t < threads; t++)
+    {
+        if (started[t])
+        {
+            pthread_join(ids[t], NULL);
+        }
+
+        for (int v = 0; v < 256; v++)
+        {
+            hist->red[v] += slices[t].hist.red[v];
+            hist->green[v] += slices[t].hist.green[v];
+            hist->blue[v] += slices[t].hist.blue[v];
+            hist->luma[v] += slices[t].hist.luma[v];
+        }
+        hist->count += slices[t].hist.count;
+    }
+    return;
+}
+
+// Find the smallest intensity at or below which at least percent of count pixels lie
+static int percentile(const uint64_t bins[256], uint64_t count, double percent)
+{
+    uint64_t rank = ceil(count * percent / 100.0);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int v = 0; v < 256; v++)
+    {
+        seen += bins[v];
+        if (seen >= rank)
+        {
+            return v;
+        }
+    }
+    return 255;
+}
+
+// Print one channel's line of statistics
+static void print_channel(const char *name, const uint64_t bins[256], uint64_t count)
+{
+    int min = 0;
+    while (min < 255 && bins[min] == 0)
+    {
+        min++;
+    }
+
+    int max = 255;
+    while (max > 0 && bins[max] == 0)
+    {
+        max--;
+    }
+
+    double sum = 0;
+    for (int v = 0; v < 256; v++)
+    {
+        sum += (double) v * bins[v];
+    }
+
+    printf("%-10s%4i%5i%8.2f", name, min, max, sum / count);
+
+    double percents[] = {1, 5, 25, 50, 75, 95, 99};
+    for (int p = 0; p < 7; p++)
+    {
+        printf("%5i", percentile(bins, count, percents[p]));
+    }
+    printf("\n");
+}
+
+// Print min, max, mean and percentiles of each channel and of luminance
+void print_stats(const HISTOGRAM *hist)
+{
+    if (hist->count == 0)
+    {
+        printf("No pixels.\n");
+        return;
+    }
+
+    printf("%llu pixels\n", (unsigned long long) hist->count);
+    printf("%-10s%4s%5s%8s%5s%5s%5s%5s%5s%5s%5s\n", "channel", "min", "max", "mean",
+           "p1", "p5", "p25", "p50", "p75", "p95", "p99");
+    print_channel("red", hist->red, hist->count);
+    print_channel("green", hist->green, hist->count);
+    print_channel("blue", hist->blue, hist->count);
+    print_channel("luminance", hist->luma, hist->count);
+}
+
+// Build one channel's LUT mapping [low, high] onto [0, 255]
+static void stretch(BYTE lut[256], int low, int high)
+{
+    for (int v = 0; v < 256; v++)
+    {
+        if (high <= low)
+        {
+            lut[v] = v;
+        }
+        else if (v <= low)
+        {
+            lut[v] = 0;
+        }
+        else if (v >= high)
+        {
+            lut[v] = 255;
+        }
+        else
+        {
+            lut[v] = round((v - low) * 255.0 / (high - low));
+        }
+    }
+}
+
+// Build a LUT stretching each channel to the full range, clipping LEVELS_CLIP percent at either end
+void levels_lut(const HISTOGRAM *hist, LUT lut)
+{
+    const uint64_t *bins[3] = {hist->blue, hist->green, hist->red};
+
+    for (int c = 0; c < 3; c++)
+    {
+        stretch(lut[c], percentile(bins[c], hist->count, LEVELS_CLIP),
+                percentile(bins[c], hist->count, 100 - LEVELS_CLIP));
+    }
+}
+
+// Build a LUMALUT remapping luminance so its histogram is flat
+void equalize_lut(const HISTOGRAM *hist, LUMALUT *lut)
+{
+    // The darkest luminance present maps to 0, so the output spans the full range
+    uint64_t lowest = 0;
+    for (int v = 0; v < 256 && lowest == 0; v++)
+    {
+        lowest = hist->luma[v];
+    }
+
+    uint64_t seen = 0;
+    for (int v = 0; v < 256; v++)
+    {
+        seen += hist->luma[v];
+
+        if (hist->count == lowest)
+        {
+            lut->map[v] = v;
+        }
+        else
+        {
+            lut->map[v] = seen < lowest ? 0 : round((double)(seen - lowest) * 255 / (hist->count - lowest));
+        }
+    }
+
+    // Black has no gain; apply_luma_lut maps it straight through map
+    lut->gains[0] = 0;
+    for (int v = 1; v < 256; v++)
+    {
+        lut->gains[v] = ((uint32_t) lut->map[v] << 16) / v;
+    }
+}
+
+// Remap the pixels of a height x width image whose scanlines are stride bytes apart
+void apply_lut(BYTE *pixels, size_t stride, int height, int width, LUT lut)
+{
+    for (int i = 0; i < height; i++)
+    {
+        RGBTRIPLE *row = (RGBTRIPLE *)(pixels + (size_t) i * stride);
+
+        for (int j = 0; j < width; j++)
+        {
+            row[j].rgbtBlue = lut[0][row[j].rgbtBlue];
+            row[j].rgbtGreen = lut[1][row[j].rgbtGreen];
+            row[j].rgbtRed = lut[2][row[j].rgbtRed];
+        }
+    }
+    return;
+}
+
+// Remap the luminance of the pixels of a height x width image whose scanlines are stride bytes apart,
+// scaling each pixel's channels alike so its hue is kept
+void apply_luma_lut(BYTE *pixels, size_t stride, int height, int width, const LUMALUT *lut)
+{
+    for (int i = 0; i < height; i++)
+    {
+        RGBTRIPLE *row = (RGBTRIPLE *)(pixels + (size_t) i * stride);
+
+        for (int j = 0; j < width; j++)
+        {
+            int y = luma(row[j]);
+
+            // Black has no hue to keep, so it becomes the gray its luminance maps to
+            if (y == 0)
+            {
+                row[j].rgbtBlue = row[j].rgbtGreen = row[j].rgbtRed = lut->map[0];
+                continue;
+            }
+
+            // Channels pushed past 255 clip, so saturated pixels land a little darker than their remapping
+            uint32_t blue = (row[j].rgbtBlue * lut->gains[y] + 0x8000) >> 16;
+            uint32_t green = (row[j].rgbtGreen * lut->gains[y] + 0x8000) >> 16;
+            uint32_t red = (row[j].rgbtRed * lut->gains[y] + 0x8000) >> 16;
+            row[j].rgbtBlue = blue > 255 ? 255 : blue;
+            row[j].rgbtGreen = green > 255 ? 255 : green;
+            row[j].rgbtRed = red > 255 ? 255 : red;
+        }
+    }
+    return;
+}
+
+// Print image's statistics, leaving it unchanged
+void stats(int height, int width, RGBTRIPLE image[height][width])
+{
+    HISTOGRAM hist;
+    histogram((BYTE *) image, width * sizeof(RGBTRIPLE), height, width, 0, &hist);
+    print_stats(&hist);
+    return;
+}
+
+// Stretch image's contrast to the full range
+void autolevels(int height, int width, RGBTRIPLE image[height][width])
+{
+    HISTOGRAM hist;
+    histogram((BYTE *) image, width * sizeof(RGBTRIPLE), height, width, 0, &hist);
+
+    LUT lut;
+    levels_lut(&hist, lut);
+    apply_lut((BYTE *) image, width * sizeof(RGBTRIPLE), height, width, lut);
+    return;
+}
+
+// Equalize image's histogram
+void equalize(int height, int width, RGBTRIPLE image[height][width])
+{
+    HISTOGRAM hist;
+    histogram((BYTE *) image, width * sizeof(RGBTRIPLE), height, width, 0, &hist);
+
+    LUMALUT lut;
+    equalize_lut(&hist, &lut);
+    apply_luma_lut((BYTE *) image, width * sizeof(RGBTRIPLE), height, width, &lut);
+    return;
+}
+
+// Apply a histogram filter to infile without decoding it, scanning the mapped file once per pass;
+// returns an exit status for main
+int histogram_file(FILE *inptr, FILE *outptr, BITMAPFILEHEADER bf, BITMAPINFOHEADER bi, char filter)
+{
+    MAPPEDBMP bmp;
+    if (map_bmp(inptr, bf, bi, &bmp) != 0)
+    {
+        printf("Could not map image.\n");
+        return 8;
+    }
+
+    // Only one scanline is decoded at a time, padding and all
+    BYTE *row = calloc(1, bmp.stride);
+    if (row == NULL)
+    {
+        unmap_bmp(&bmp);
+        printf("Not enough memory to store image.\n");
+        return 7;
+    }
+
+    // First pass: count
+    HISTOGRAM hist;
+    histogram(bmp.pixels, bmp.stride, bmp.height, bmp.width, 1, &hist);
+
+    LUT lut;
+    LUMALUT luma_lut;
+    switch (filter)
+    {
+        // Equalize
+        case 'h':
+            equalize_lut(&hist, &luma_lut);
+            break;
+
+        // Auto-levels
+        case 'n':
+            levels_lut(&hist, lut);
+            break;
+
+        // Stats, passing pixels through
+        default:
+            print_stats(&hist);
+            for (int v = 0; v < 256; v++)
+            {
+                lut[0][v] = lut[1][v] = lut[2][v] = v;
+            }
+            break;
+    }
+
+    // Write outfile's headers
+    fwrite(&bf, sizeof(BITMAPFILEHEADER), 1, outptr);
+    fwrite(&bi, sizeof(BITMAPINFOHEADER), 1, outptr);
+
+    // Second pass: remap each scanline of the mapped infile into outfile
+    for (int i = 0; i < bmp.height; i++)
+    {
+        memcpy(row, bmp.pixels + (size_t) i * bmp.stride, bmp.width * sizeof(RGBTRIPLE));
+        if (filter == 'h')
+        {
+            apply_luma_lut(row, bmp.stride, 1, bmp.width, &luma_lut);
+        }
+        else
+        {
+            apply_lut(row, bmp.stride, 1, bmp.width, lut);
+        }
+        fwrite(row, 1, bmp.stride, outptr);
+
+        if ((i + 1) % RELEASE_ROWS == 0 || i + 1 == bmp.height)
+        {
+            int done = i % RELEASE_ROWS + 1;
+            release_range(bmp.pixels + (size_t)(i + 1 - done) * bmp.stride, (size_t) done * bmp.stride);
+        }
+    }
+
+    free(row);
+    unmap_bmp(&bmp);
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Histogram statistics and the contrast filters built on them
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bmp.h"
+
+// Most threads a histogram pass is split across
+#ifndef HISTOGRAM_THREADS
+#define HISTOGRAM_THREADS 16
+#endif
+
+// Fewest rows worth handing a thread of its own
+#ifndef HISTOGRAM_ROWS
+#define HISTOGRAM_ROWS 64
+#endif
+
+// Rows of a mapped image scanned between drops of its pages from memory
+#ifndef RELEASE_ROWS
+#define RELEASE_ROWS 64
+#endif
+
+// Percent of pixels auto-levels clips at each end of every channel, so stray specks don't pin the range
+#ifndef LEVELS_CLIP
+#define LEVELS_CLIP 0.5
+#endif
+
+/**
+ * HISTOGRAM
+ *
+ * Counts of each intensity per channel, plus of Rec. 601 luminance,
+ * over count pixels.
+ */
+typedef struct
+{
+    uint64_t  red[256];
+    uint64_t  green[256];
+    uint64_t  blue[256];
+    uint64_t  luma[256];
+    uint64_t  count;
+}
+HISTOGRAM;
+
+/**
+ * LUT
+ *
+ * A remapping of every intensity, per channel, indexed in RGBTRIPLE's
+ * byte order: blue, green, red.
+ */
+typedef BYTE LUT[3][256];
+
+/**
+ * LUMALUT
+ *
+ * A remapping of every luminance, with the gain (16.16 fixed point) that
+ * takes each luminance to its remapping, so applying it needs no division.
+ */
+typedef struct
+{
+    BYTE      map[256];
+    uint32_t  gains[256];
+}
+LUMALUT;
+
+// Count the pixels of a height x width image whose scanlines are stride bytes apart, dropping scanned
+// rows from memory if release is set (only safe for mapped images)
+void histogram(const BYTE *pixels, size_t stride, int height, int width, int release, HISTOGRAM *hist);
+
+// Print min, max, mean and percentiles of each channel and of luminance
+void print_stats(const HISTOGRAM *hist);
+
+// Build a LUT stretching each channel to the full range, clipping LEVELS_CLIP percent at either end
+void levels_lut(const HISTOGRAM *hist, LUT lut);
+
+// Build a LUMALUT remapping luminance so its histogram is flat
+void equalize_lut(const HISTOGRAM *hist, LUMALUT *lut);
+
+// Remap the pixels of a height x width image whose scanlines are stride bytes apart
+void apply_lut(BYTE *pixels, size_t stride, int height, int width, LUT lut);
+
+// Remap the luminance of the pixels of a height x width image whose scanlines are stride bytes apart,
+// scaling each pixel's channels alike so its hue is kept
+void apply_luma_lut(BYTE *pixels, size_t stride, int height, int width, const LUMALUT *lut);
+
+// Print image's statistics, leaving it unchanged
+void stats(int height, int width, RGBTRIPLE image[height][width]);
+
+// Stretch image's contrast to the full range
+void autolevels(int height, int width, RGBTRIPLE image[height][width]);
+
+// Equalize image's histogram
+void equalize(int height, int width, RGBTRIPLE image[height][width]);
+
+// Apply a histogram filter to infile without decoding it, scanning the mapped file once per pass;
+// returns an exit status for main
+int histogram_file(FILE *inptr, FILE *outptr, BITMAPFILEHEADER bf, BITMAPINFOHEADER bi, char filter);
+
+#endif
@@ -0,0 +1,287 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "rotate.h"
+#include "stream.h"
+
+/**
+ * SOURCEMAP
+ *
+ * Where a rotation finds output pixel (y, x) in its source: at row
+ * row0 + row_y * y + row_x * x and column col0 + col_y * y + col_x * x.
+ */
+typedef struct
+{
+    int  row0, col0;
+    int  row_y, col_y;
+    int  row_x, col_x;
+}
+SOURCEMAP;
+
+// Map a filter flag to the rotation of stored rows that turns the image as displayed
+ROTATION rotation_for(char filter, LONG biHeight)
+{
+    // Bottom-up images (positive biHeight) store their rows upside down, which mirrors every turn
+    int bottom_up = biHeight > 0;
+
+    switch (filter)
+    {
+        case 'a':
+            return bottom_up ? ROTATE_90 : ROTATE_270;
+
+        case 'c':
+            return bottom_up ? ROTATE_270 : ROTATE_90;
+
+        case 't':
+            return bottom_up ? TRANSVERSE : TRANSPOSE;
+
+        default:
+            return ROTATE_180;
+    }
+}
+
+// Describe where rotation finds each output pixel in a height x width source
+static SOURCEMAP source_map(int height, int width, ROTATION rotation)
+{
+    switch (rotation)
+    {
+        case ROTATE_90:
+            return (SOURCEMAP) { height - 1, 0, 0, 1, -1, 0 };
+
+        case ROTATE_270:
+            return (SOURCEMAP) { 0, width - 1, 0, -1, 1, 0 };
+
+        case TRANSPOSE:
+            return (SOURCEMAP) { 0, 0, 0, 1, 1, 0 };
+
+        case TRANSVERSE:
+            return (SOURCEMAP) { height - 1, width - 1, 0, -1, -1, 0 };
+
+        default:
+            return (SOURCEMAP) { height - 1, width - 1, -1, 0, 0, -1 };
+    }
+}
+
+// Copy the rows x cols output tile at (y0, x0) out of pixels, whose scanlines are stride bytes apart
+static void copy_tile(const BYTE *pixels, size_t stride, SOURCEMAP map, int y0, int x0, int rows, int cols,
+                      BYTE *tile, size_t tile_stride)
+{
+    const BYTE *src = pixels + (ptrdiff_t)(map.row0 + map.row_y * y0 + map.row_x * x0) * (ptrdiff_t) stride +
+                      (ptrdiff_t)(map.col0 + map.col_y * y0 + map.col_x * x0) * (ptrdiff_t) sizeof(RGBTRIPLE);
+    ptrdiff_t step_y = map.row_y * (ptrdiff_t) stride + map.col_y * (ptrdiff_t) sizeof(RGBTRIPLE);
+    ptrdiff_t step_x = map.row_x * (ptrdiff_t) stride + map.col_x * (ptrdiff_t) sizeof(RGBTRIPLE);
+
+    for (int y = 0; y < rows; y++)
+    {
+        const BYTE *s = src + y * step_y;
+        RGBTRIPLE *d = (RGBTRIPLE *)(tile + y * tile_stride);
+
+        for (int x = 0; x < cols; x++)
+        {
+            d[x] = *(const RGBTRIPLE *) s;
+            s += step_x;
+        }
+    }
+}
+
+// Describe the rotated image in bf and bi, keeping infile's row order
+static void rotate_headers(BITMAPFILEHEADER *bf, BITMAPINFOHEADER *bi, ROTATION rotation)
+{
+    if (rotation != ROTATE_180)
+    {
+        LONG height = abs(bi->biHeight);
+        bi->biHeight = bi->biHeight < 0 ? -bi->biWidth : bi->biWidth;
+        bi->biWidth = height;
+
+        LONG pels = bi->biXPelsPerMeter;
+        bi->biXPelsPerMeter = bi->biYPelsPerMeter;
+        bi->biYPelsPerMeter = pels;
+    }
+
+    bi->biSizeImage = scanline_size(bi->biWidth) * abs(bi->biHeight);
+    bf->bfSize = bf->bfOffBits + bi->biSizeImage;
+}
+
+// Rotate image into rotated, which holds height * width pixels
+void rotate(int height, int width, RGBTRIPLE image[height][width], RGBTRIPLE *rotated, ROTATION rotation)
+{
+    SOURCEMAP map = source_map(height, width, rotation);
+    int out_height = rotation == ROTATE_180 ? height : width;
+    int out_width = rotation == ROTATE_180 ? width : height;
+
+    // Whole tiles at a time, so the source rows a tile gathers from stay cached until it is done
+    for (int y0 = 0; y0 < out_height; y0 += ROTATE_TILE)
+    {
+        int rows = out_height - y0 < ROTATE_TILE ? out_height - y0 : ROTATE_TILE;
+
+        for (int x0 = 0; x0 < out_width; x0 += ROTATE_TILE)
+        {
+            int cols = out_width - x0 < ROTATE_TILE ? out_width - x0 : ROTATE_TILE;
+
+            copy_tile((BYTE *) image, width * sizeof(RGBTRIPLE), map, y0, x0, rows, cols,
+                      (BYTE *)(rotated + (size_t) y0 * out_width + x0), out_width * sizeof(RGBTRIPLE));
+        }
+    }
+    return;
+}
+
+// Decode infile, rotate it and write it to outfile
+static int rotate_in_memory(FILE *inptr, FILE *outptr, BITMAPFILEHEADER bf, BITMAPINFOHEADER bi, ROTATION rotation)
+{
+    int height = abs(bi.biHeight);
+    int width = bi.biWidth;
+
+    // Allocate memory for image and its rotation
+    RGBTRIPLE(*image)[width] = calloc(height, width * sizeof(RGBTRIPLE));
+    RGBTRIPLE *rotated = calloc((size_t) height * width, sizeof(RGBTRIPLE));
+    if (image == NULL || rotated == NULL)
+    {
+        free(rotated);
+        free(image);
+        printf("Not enough memory to store image.\n");
+        return 7;
+    }
+
+    // Determine padding for scanlines
+    int padding = (4 - (width * sizeof(RGBTRIPLE)) % 4) % 4;
+
+    // Iterate over infile's scanlines
+    for (int i = 0; i < height; i++)
+    {
+        // Read row into pixel array
+        fread(image[i], sizeof(RGBTRIPLE), width, inptr);
+
+        // Skip over padding
+        fseek(inptr, padding, SEEK_CUR);
+    }
+
+    rotate(height, width, image, rotated, rotation);
+
+    // Write outfile's headers
+    rotate_headers(&bf, &bi, rotation);
+    fwrite(&bf, sizeof(BITMAPFILEHEADER), 1, outptr);
+    fwrite(&bi, sizeof(BITMAPINFOHEADER), 1, outptr);
+
+    // Write new pixels to outfile
+    height = abs(bi.biHeight);
+    width = bi.biWidth;
+    padding = (4 - (width * sizeof(RGBTRIPLE)) % 4) % 4;
+    for (int i = 0; i < height; i++)
+    {
+        fwrite(rotated + (size_t) i * width, sizeof(RGBTRIPLE), width, outptr);
+
+        for (int k = 0; k < padding; k++)
+        {
+            fputc(0x00, outptr);
+        }
+    }
+
+    free(rotated);
+    free(image);
+    return 0;
+}
+
+// Rotate infile into outfile without decoding it, staging tiles through a scratch file
+static int rotate_out_of_core(FILE *inptr, FILE *outptr, BITMAPFILEHEADER bf, BITMAPINFOHEADER bi,
+                              ROTATION rotation)
+{
+    MAPPEDBMP bmp;
+    if (map_bmp(inptr, bf, bi, &bmp) != 0)
+    {
+        printf("Could not map image.\n");
+        return 8;
+    }
+
+    SOURCEMAP map = source_map(bmp.height, bmp.width, rotation);
+    int quarter = rotation != ROTATE_180;
+    int out_height = quarter ? bmp.width : bmp.height;
+    int out_width = quarter ? bmp.height : bmp.width;
+
+    // The scratch file holds the output in ROTATE_TILE-row bands, each band's tiles stored one after another
+    size_t size = (size_t) out_height * out_width * sizeof(RGBTRIPLE);
+    BYTE *scratch = map_scratch(size);
+    if (scratch == NULL)
+    {
+        unmap_bmp(&bmp);
+        printf("Could not create scratch file.\n");
+        return 8;
+    }
+
+    // Stage one strip of tiles at a time, a strip being the tiles fed by one band of ROTATE_TILE source rows,
+    // so only that band and the tiles it fills are resident
+    int strips = quarter ? out_width : out_height;
+    int along = quarter ? out_height : out_width;
+    int row_step = quarter ? map.row_x : map.row_y;
+    for (int s0 = 0; s0 < strips; s0 += ROTATE_TILE)
+    {
+        int s1 = strips - s0 < ROTATE_TILE ? strips : s0 + ROTATE_TILE;
+
+        for (int a0 = 0; a0 < along; a0 += ROTATE_TILE)
+        {
+            int a1 = along - a0 < ROTATE_TILE ? along : a0 + ROTATE_TILE;
+            int y0 = quarter ? a0 : s0;
+            int y1 = quarter ? a1 : s1;
+            int x0 = quarter ? s0 : a0;
+            int x1 = quarter ? s1 : a1;
+
+            BYTE *tile = scratch + ((size_t) y0 * out_width + (size_t) x0 * (y1 - y0)) * sizeof(RGBTRIPLE);
+            copy_tile(bmp.pixels, bmp.stride, map, y0, x0, y1 - y0, x1 - x0, tile, (x1 - x0) * sizeof(RGBTRIPLE));
+        }
+
+        int first = map.row0 + row_step * s0;
+        int last = map.row0 + row_step * (s1 - 1);
+        if (first > last)
+        {
+            int swap = first;
+            first = last;
+            last = swap;
+        }
+        release_range(bmp.pixels + (size_t) first * bmp.stride, (size_t)(last - first + 1) * bmp.stride);
+        release_range(scratch, size);
+    }
+    unmap_bmp(&bmp);
+
+    // Write outfile's headers
+    rotate_headers(&bf, &bi, rotation);
+    fwrite(&bf, sizeof(BITMAPFILEHEADER), 1, outptr);
+    fwrite(&bi, sizeof(BITMAPINFOHEADER), 1, outptr);
+
+    // Write new pixels to outfile a band at a time, gathering each row from the band's tiles
+    int padding = (4 - (out_width * sizeof(RGBTRIPLE)) % 4) % 4;
+    for (int y0 = 0; y0 < out_height; y0 += ROTATE_TILE)
+    {
+        int rows = out_height - y0 < ROTATE_TILE ? out_height - y0 : ROTATE_TILE;
+        BYTE *band = scratch + (size_t) y0 * out_width * sizeof(RGBTRIPLE);
+
+        for (int y = 0; y < rows; y++)
+        {
+            for (int x0 = 0; x0 < out_width; x0 += ROTATE_TILE)
+            {
+                int cols = out_width - x0 < ROTATE_TILE ? out_width - x0 : ROTATE_TILE;
+                fwrite(band + ((size_t) x0 * rows + (size_t) y * cols) * sizeof(RGBTRIPLE), sizeof(RGBTRIPLE), cols,
+                       outptr);
+            }
+
+            for (int k = 0; k < padding; k++)
+            {
+                fputc(0x00, outptr);
+            }
+        }
+        release_range(band, (size_t) rows * out_width * sizeof(RGBTRIPLE));
+    }
+
+    unmap_scratch(scratch, size);
+    return 0;
+}
+
+// Rotate infile into outfile, out of core if it exceeds the memory budget; returns an exit status for main
+int rotate_file(FILE *inptr, FILE *outptr, BITMAPFILEHEADER bf, BITMAPINFOHEADER bi, ROTATION rotation)
+{
+    // Decoding needs room for the image twice over, once as read and once rotated
+    size_t size = (size_t) abs(bi.biHeight) * bi.biWidth * sizeof(RGBTRIPLE);
+    if (2 * size <= memory_budget())
+    {
+        return rotate_in_memory(inptr, outptr, bf, bi, rotation);
+    }
+    return rotate_out_of_core(inptr, outptr, bf, bi, rotation);
+}
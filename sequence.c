@@ -0,0 +1,543 @@
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "helpers.h"
+#include "histogram.h"
+#include "sequence.h"
+
+/**
+ * SEQUENCE
+ *
+ * A frame sequence being read ahead by the prefetch thread. Frame buffers
+ * come from a pool allocated once; the prefetch thread fills free ones and
+ * queues them ready, in order, and the filtering thread recycles them.
+ */
+typedef struct
+{
+    const char        *pattern;
+    int                first;
+    BITMAPFILEHEADER   bf;
+    BITMAPINFOHEADER   bi;
+    int                height;
+    int                width;
+
+    pthread_mutex_t    lock;
+    pthread_cond_t     freed;
+    pthread_cond_t     filled;
+    RGBTRIPLE        **spare;
+    int                nspare;
+    RGBTRIPLE        **ready;
+    int               *indices;
+    int                head;
+    int                nready;
+    int                capacity;
+    int                done;
+    int                stop;
+    int                status;
+}
+SEQUENCE;
+
+// Whether a filename holds exactly one integer conversion, as in frame_%05d.bmp
+int is_pattern(const char *name)
+{
+    int conversions = 0;
+
+    for (const char *c = strchr(name, '%'); c != NULL; c = strchr(c + 1, '%'))
+    {
+        // A literal percent sign
+        if (c[1] == '%')
+        {
+            c++;
+            continue;
+        }
+
+        // Flags and width are allowed, nothing else
+        c++;
+        while (*c == '0' || *c == '-' || *c == '+' || *c == ' ')
+        {
+            c++;
+        }
+        while (isdigit((unsigned char) *c))
+        {
+            c++;
+        }
+        if (*c != 'd' && *c != 'i')
+        {
+            return 0;
+        }
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// Format a pattern's filename for frame index into a buffer the caller frees
+static char *frame_name(const char *pattern, int index)
+{
+    int length = snprintf(NULL, 0, pattern, index);
+    char *name = malloc(length + 1);
+    if (name != NULL)
+    {
+        snprintf(name, length + 1, pattern, index);
+    }
+    return name;
+}
+
+// Open frame index of pattern, or return NULL if it doesn't exist
+static FILE *open_frame(const char *pattern, int index)
+{
+    char *name = frame_name(pattern, index);
+    if (name == NULL)
+    {
+        return NULL;
+    }
+
+    FILE *inptr = fopen(name, "r");
+    free(name);
+    return inptr;
+}
+
+// Whether headers describe a (likely) 24-bit uncompressed BMP 4.0
+static int supported(BITMAPFILEHEADER bf, BITMAPINFOHEADER bi)
+{
+    return bf.bfType == 0x4d42 && bf.bfOffBits == 54 && bi.biSize == 40 &&
+           bi.biBitCount == 24 && bi.biCompression == 0;
+}
+
+// Read a frame into pixels, which must be the size of the sequence's frames; returns an exit status for main
+static int read_frame(SEQUENCE *seq, FILE *inptr, int index, RGBTRIPLE *pixels)
+{
+    BITMAPFILEHEADER bf;
+    BITMAPINFOHEADER bi;
+    if (fread(&bf, sizeof(BITMAPFILEHEADER), 1, inptr) != 1 ||
+        fread(&bi, sizeof(BITMAPINFOHEADER), 1, inptr) != 1 || !supported(bf, bi))
+    {
+        printf("Frame %i: unsupported file format.\n", index);
+        return 6;
+    }
+
+    if (bi.biWidth != seq->bi.biWidth || bi.biHeight != seq->bi.biHeight)
+    {
+        printf("Frame %i: size differs from frame %i.\n", index, seq->first);
+        return 6;
+    }
+
+    // Determine padding for scanlines
+    int padding = (4 - (seq->width * sizeof(RGBTRIPLE)) % 4) % 4;
+
+    // Iterate over infile's scanlines
+    for (int i = 0; i < seq->height; i++)
+    {
+        // Read row into pixel array
+        fread(pixels + (size_t) i * seq->width, sizeof(RGBTRIPLE), seq->width, inptr);
+
+        // Skip over padding
+        fseek(inptr, padding, SEEK_CUR);
+    }
+    return 0;
+}
+
+// Write pixels to frame index of pattern; returns an exit status for main
+static int write_frame(SEQUENCE *seq, const char *pattern, int index, RGBTRIPLE *pixels)
+{
+    char *name = frame_name(pattern, index);
+    FILE *outptr = name == NULL ? NULL : fopen(name, "w");
+    if (outptr == NULL)
+    {
+        printf("Could not create %s.\n", name == NULL ? pattern : name);
+        free(name);
+        return 5;
+    }
+    free(name);
+
+    // Write outfile's headers
+    fwrite(&seq->bf, sizeof(BITMAPFILEHEADER), 1, outptr);
+    fwrite(&seq->bi, sizeof(BITMAPINFOHEADER), 1, outptr);
+
+    // Write new pixels to outfile
+    int padding = (4 - (seq->width * sizeof(RGBTRIPLE)) % 4) % 4;
+    for (int i = 0; i < seq->height; i++)
+    {
+        fwrite(pixels + (size_t) i * seq->width, sizeof(RGBTRIPLE), seq->width, outptr);
+
+        for (int k = 0; k < padding; k++)
+        {
+            fputc(0x00, outptr);
+        }
+    }
+
+    fclose(outptr);
+    return 0;
+}
+
+// Read frames ahead into free buffers until the sequence ends or the filtering thread stops it
+static void *prefetch(void *arg)
+{
+    SEQUENCE *seq = arg;
+
+    for (int index = seq->first; ; index++)
+    {
+        // The sequence ends at its first missing frame
+        FILE *inptr = open_frame(seq->pattern, index);
+        if (inptr == NULL)
+        {
+            break;
+        }
+
+        pthread_mutex_lock(&seq->lock);
+        while (seq->nspare == 0 && !seq->stop)
+        {
+            pthread_cond_wait(&seq->freed, &seq->lock);
+        }
+        if (seq->stop)
+        {
+            pthread_mutex_unlock(&seq->lock);
+            fclose(inptr);
+            break;
+        }
+        RGBTRIPLE *pixels = seq->spare[--seq->nspare];
+        pthread_mutex_unlock(&seq->lock);
+
+        int status = read_frame(seq, inptr, index, pixels);
+        fclose(inptr);
+
+        pthread_mutex_lock(&seq->lock);
+        if (status != 0)
+        {
+            seq->status = status;
+            seq->spare[seq->nspare++] = pixels;
+            pthread_mutex_unlock(&seq->lock);
+            break;
+        }
+        int tail = (seq->head + seq->nready) % seq->capacity;
+        seq->ready[tail] = pixels;
+        seq->indices[tail] = index;
+        seq->nready++;
+        pthread_cond_signal(&seq->filled);
+        pthread_mutex_unlock(&seq->lock);
+    }
+
+    pthread_mutex_lock(&seq->lock);
+    seq->done = 1;
+    pthread_cond_signal(&seq->filled);
+    pthread_mutex_unlock(&seq->lock);
+    return NULL;
+}
+
+// Take the next frame read, waiting for it if need be; returns NULL once the sequence ends
+static RGBTRIPLE *next_frame(SEQUENCE *seq, int *index)
+{
+    pthread_mutex_lock(&seq->lock);
+    while (seq->nready == 0 && !seq->done)
+    {
+        pthread_cond_wait(&seq->filled, &seq->lock);
+    }
+
+    RGBTRIPLE *pixels = NULL;
+    if (seq->nready > 0)
+    {
+        pixels = seq->ready[seq->head];
+        *index = seq->indices[seq->head];
+        seq->head = (seq->head + 1) % seq->capacity;
+        seq->nready--;
+    }
+    pthread_mutex_unlock(&seq->lock);
+    return pixels;
+}
+
+// Hand a frame buffer back to the pool
+static void recycle(SEQUENCE *seq, RGBTRIPLE *pixels)
+{
+    pthread_mutex_lock(&seq->lock);
+    seq->spare[seq->nspare++] = pixels;
+    pthread_cond_signal(&seq->freed);
+    pthread_mutex_unlock(&seq->lock);
+}
+
+// Apply an in-place filter to one frame, using scratch (a frame's worth) instead of a stack copy of it
+static void filter_frame(SEQUENCE *seq, char filter, int index, RGBTRIPLE *pixels, RGBTRIPLE *scratch)
+{
+    int height = seq->height;
+    int width = seq->width;
+    RGBTRIPLE(*image)[width] = (RGBTRIPLE(*)[width]) pixels;
+    RGBTRIPLE(*temp_image)[width] = (RGBTRIPLE(*)[width]) scratch;
+
+    switch (filter)
+    {
+        // Blur
+        case 'b':
+            blur_buffered(height, width, image, temp_image);
+            break;
+
+        // Edges
+        case 'e':
+            edges_buffered(height, width, image, temp_image);
+            break;
+
+        // Grayscale
+        case 'g':
+            grayscale(height, width, image);
+            break;
+
+        // Equalize
+        case 'h':
+            equalize(height, width, image);
+            break;
+
+        // Auto-levels
+        case 'n':
+            autolevels(height, width, image);
+            break;
+
+        // Reflect
+        case 'r':
+            reflect(height, width, image);
+            break;
+
+        // Stats
+        case 's':
+            printf("Frame %i: ", index);
+            stats(height, width, image);
+            break;
+    }
+}
+
+// Write the absolute difference of two frames' bytes into out
+static void difference(const BYTE *a, const BYTE *b, BYTE *out, size_t size)
+{
+    for (size_t k = 0; k < size; k++)
+    {
+        out[k] = a[k] > b[k] ? a[k] - b[k] : b[k] - a[k];
+    }
+}
+
+// Write a frame's difference from the running-average background into out, then fold it into the background,
+// which keeps 8 fractional bits per byte
+static void subtract_background(const BYTE *frame, uint16_t *background, BYTE *out, size_t size)
+{
+    int half = 1 << (BACKGROUND_SHIFT - 1);
+
+    for (size_t k = 0; k < size; k++)
+    {
+        int level = (background[k] + 128) >> 8;
+        out[k] = frame[k] > level ? frame[k] - level : level - frame[k];
+
+        // Round the step half away from zero, so a static scene settles onto its level from above or below
+        int delta = ((int) frame[k] << 8) - background[k];
+        background[k] += delta >= 0 ? (delta + half) >> BACKGROUND_SHIFT : -((half - delta) >> BACKGROUND_SHIFT);
+    }
+}
+
+// Write the median of count frames' bytes into out
+static void median(RGBTRIPLE **frames, int count, BYTE *out, size_t size)
+{
+    BYTE values[SEQUENCE_MAX_WINDOW] = {0};
+
+    for (size_t k = 0; k < size; k++)
+    {
+        // Insertion sort; windows are short
+        for (int f = 0; f < count; f++)
+        {
+            BYTE v = ((BYTE *) frames[f])[k];
+            int slot = f;
+            while (slot > 0 && values[slot - 1] > v)
+            {
+                values[slot] = values[slot - 1];
+                slot--;
+            }
+            values[slot] = v;
+        }
+        out[k] = values[count / 2];
+    }
+}
+
+// Filter each frame of inpattern into outpattern, from frame 0 (or 1) up to the first missing one, with
+// temporal filters spanning window frames; returns an exit status for main
+int filter_sequence(const char *inpattern, const char *outpattern, char filter, int window)
+{
+    if (!is_pattern(inpattern) || !is_pattern(outpattern))
+    {
+        printf("Frame patterns need one integer conversion each, like frame_%%05d.bmp.\n");
+        return 3;
+    }
+
+    if (strchr("actu", filter) != NULL)
+    {
+        printf("Rotations are not supported on sequences.\n");
+        return 1;
+    }
+
+    SEQUENCE seq = {.pattern = inpattern, .first = 0};
+
+    // Numbering starts at 0 or 1; the first frame sets every frame's size
+    FILE *inptr = open_frame(inpattern, seq.first);
+    if (inptr == NULL)
+    {
+        inptr = open_frame(inpattern, ++seq.first);
+    }
+    if (inptr == NULL)
+    {
+        printf("Could not open frame 0 or 1 of %s.\n", inpattern);
+        return 4;
+    }
+    if (fread(&seq.bf, sizeof(BITMAPFILEHEADER), 1, inptr) != 1 ||
+        fread(&seq.bi, sizeof(BITMAPINFOHEADER), 1, inptr) != 1 || !supported(seq.bf, seq.bi))
+    {
+        fclose(inptr);
+        printf("Unsupported file format.\n");
+        return 6;
+    }
+    fclose(inptr);
+
+    seq.height = abs(seq.bi.biHeight);
+    seq.width = seq.bi.biWidth;
+    size_t size = (size_t) seq.height * seq.width * sizeof(RGBTRIPLE);
+
+    // Frames the filtering thread holds at once: the current one, plus the previous one or the median's window
+    int held = filter == 'd' ? 2 : filter == 'm' ? window : 1;
+    seq.capacity = held + SEQUENCE_PREFETCH;
+
+    // Allocate every buffer up front; frames are recycled, never reallocated
+    BYTE *frames = calloc(seq.capacity, size);
+    BYTE *out = calloc(1, size);
+    uint16_t *background = filter == 'f' ? calloc(size, sizeof(uint16_t)) : NULL;
+    RGBTRIPLE **history = calloc(held, sizeof(RGBTRIPLE *));
+    seq.spare = calloc(seq.capacity, sizeof(RGBTRIPLE *));
+    seq.ready = calloc(seq.capacity, sizeof(RGBTRIPLE *));
+    seq.indices = calloc(seq.capacity, sizeof(int));
+    if (frames == NULL || out == NULL || (filter == 'f' && background == NULL) || history == NULL ||
+        seq.spare == NULL || seq.ready == NULL || seq.indices == NULL)
+    {
+        free(seq.indices);
+        free(seq.ready);
+        free(seq.spare);
+        free(history);
+        free(background);
+        free(out);
+        free(frames);
+        printf("Not enough memory to store frames.\n");
+        return 7;
+    }
+    for (int f = 0; f < seq.capacity; f++)
+    {
+        seq.spare[seq.nspare++] = (RGBTRIPLE *)(frames + f * size);
+    }
+
+    pthread_mutex_init(&seq.lock, NULL);
+    pthread_cond_init(&seq.freed, NULL);
+    pthread_cond_init(&seq.filled, NULL);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t reader;
+    int started = pthread_create(&reader, NULL, prefetch, &seq) == 0;
+    if (!started)
+    {
+        seq.status = 8;
+        seq.done = 1;
+        printf("Could not start prefetch thread.\n");
+    }
+
+    // history holds the frames the temporal filters still need, oldest first
+    int status = 0;
+    int count = 0;
+    int nhistory = 0;
+    int index;
+    RGBTRIPLE *pixels;
+    while (status == 0 && (pixels = next_frame(&seq, &index)) != NULL)
+    {
+        RGBTRIPLE *result = (RGBTRIPLE *) out;
+
+        switch (filter)
+        {
+            // Frame differencing, against the previous frame
+            case 'd':
+                difference((BYTE *) pixels, (BYTE *)(nhistory > 0 ? history[0] : pixels), out, size);
+                if (nhistory > 0)
+                {
+                    recycle(&seq, history[0]);
+                }
+                history[0] = pixels;
+                nhistory = 1;
+                break;
+
+            // Foreground, by running-average background subtraction
+            case 'f':
+                if (count == 0)
+                {
+                    for (size_t k = 0; k < size; k++)
+                    {
+                        background[k] = ((BYTE *) pixels)[k] << 8;
+                    }
+                }
+                subtract_background((BYTE *) pixels, background, out, size);
+                recycle(&seq, pixels);
+                break;
+
+            // Temporal median over the last window frames
+            case 'm':
+                if (nhistory == window)
+                {
+                    recycle(&seq, history[0]);
+                    memmove(history, history + 1, (window - 1) * sizeof(RGBTRIPLE *));
+                    nhistory--;
+                }
+                history[nhistory++] = pixels;
+                median(history, nhistory, out, size);
+                break;
+
+            // Spatial filters, in place
+            default:
+                filter_frame(&seq, filter, index, pixels, (RGBTRIPLE *) out);
+                result = pixels;
+                break;
+        }
+
+        status = write_frame(&seq, outpattern, index, result);
+        if (result == pixels)
+        {
+            recycle(&seq, pixels);
+        }
+        if (status == 0)
+        {
+            count++;
+        }
+    }
+
+    // Stop the reader if filtering gave up early
+    pthread_mutex_lock(&seq.lock);
+    seq.stop = 1;
+    pthread_cond_signal(&seq.freed);
+    pthread_mutex_unlock(&seq.lock);
+    if (started)
+    {
+        pthread_join(reader, NULL);
+    }
+    if (status == 0)
+    {
+        status = seq.status;
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Filtered %i frames in %.2f s (%.1f frames per second).\n", count, seconds,
+           seconds > 0 ? count / seconds : 0.0);
+
+    pthread_cond_destroy(&seq.filled);
+    pthread_cond_destroy(&seq.freed);
+    pthread_mutex_destroy(&seq.lock);
+    free(seq.indices);
+    free(seq.ready);
+    free(seq.spare);
+    free(history);
+    free(background);
+    free(out);
+    free(frames);
+    return status;
+}
@@ -0,0 +1,28 @@
+// Numbered frame sequences, read ahead into a fixed pool of frame buffers
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+// Frames read ahead of the one being filtered
+#ifndef SEQUENCE_PREFETCH
+#define SEQUENCE_PREFETCH 4
+#endif
+
+// Most frames a temporal median may span
+#ifndef SEQUENCE_MAX_WINDOW
+#define SEQUENCE_MAX_WINDOW 31
+#endif
+
+// Background subtraction's running average weighs each new frame 1 / 2^BACKGROUND_SHIFT
+#ifndef BACKGROUND_SHIFT
+#define BACKGROUND_SHIFT 4
+#endif
+
+// Whether a filename holds exactly one integer conversion, as in frame_%05d.bmp
+int is_pattern(const char *name);
+
+// Filter each frame of inpattern into outpattern, from frame 0 (or 1) up to the first missing one, with
+// temporal filters spanning window frames; returns an exit status for main
+int filter_sequence(const char *inpattern, const char *outpattern, char filter, int window);
+
+#endif
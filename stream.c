@@ -0,0 +1,109 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stream.h"
+
+// Bytes of pixel data allowed in memory, overridable with the FILTER_MEMORY_MB environment variable
+size_t memory_budget(void)
+{
+    size_t megabytes = MEMORY_BUDGET_MB;
+
+    char *setting = getenv("FILTER_MEMORY_MB");
+    if (setting != NULL && atol(setting) > 0)
+    {
+        megabytes = atol(setting);
+    }
+    return megabytes << 20;
+}
+
+// Bytes per scanline of an image width pixels wide, padding included
+size_t scanline_size(int width)
+{
+    return ((size_t) width * sizeof(RGBTRIPLE) + 3) & ~(size_t) 3;
+}
+
+// Map infile's pixel array; returns 0 on success
+int map_bmp(FILE *inptr, BITMAPFILEHEADER bf, BITMAPINFOHEADER bi, MAPPEDBMP *bmp)
+{
+    bmp->height = abs(bi.biHeight);
+    bmp->width = bi.biWidth;
+    bmp->stride = scanline_size(bmp->width);
+    bmp->length = bf.bfOffBits + bmp->stride * bmp->height;
+
+    // Refuse truncated files rather than fault on their missing pages
+    struct stat st;
+    if (fstat(fileno(inptr), &st) != 0 || (size_t) st.st_size < bmp->length)
+    {
+        return 1;
+    }
+
+    void *base = mmap(NULL, bmp->length, PROT_READ, MAP_PRIVATE, fileno(inptr), 0);
+    if (base == MAP_FAILED)
+    {
+        return 1;
+    }
+
+    bmp->base = base;
+    bmp->pixels = bmp->base + bf.bfOffBits;
+    return 0;
+}
+
+// Unmap infile's pixel array
+void unmap_bmp(MAPPEDBMP *bmp)
+{
+    munmap(bmp->base, bmp->length);
+    bmp->base = bmp->pixels = NULL;
+}
+
+// Map an unlinked scratch file of size bytes read-write; returns NULL on failure
+BYTE *map_scratch(size_t size)
+{
+    // Scratch files can be as large as the image, so honour TMPDIR instead of assuming /tmp has room
+    char *dir = getenv("TMPDIR");
+    if (dir == NULL || *dir == '\0')
+    {
+        dir = "/tmp";
+    }
+
+    char path[strlen(dir) + sizeof("/filter-XXXXXX")];
+    strcpy(path, dir);
+    strcat(path, "/filter-XXXXXX");
+
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    unlink(path);
+
+    void *scratch = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+    {
+        scratch = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    // The mapping keeps the file alive until it is unmapped
+    close(fd);
+    return scratch == MAP_FAILED ? NULL : scratch;
+}
+
+// Unmap a scratch file, discarding it
+void unmap_scratch(BYTE *scratch, size_t size)
+{
+    munmap(scratch, size);
+}
+
+// Drop the pages of a mapping covering [start, start + length) from resident memory
+void release_range(const void *start, size_t length)
+{
+    // File-backed pages are only dropped from this process; the page cache keeps them, dirty or not
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t) start & ~(page - 1);
+    uintptr_t last = ((uintptr_t) start + length + page - 1) & ~(page - 1);
+    madvise((void *) first, last - first, MADV_DONTNEED);
+}
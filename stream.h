@@ -0,0 +1,54 @@
+// Memory-mapped access to BMP pixel data, for images too large to decode into memory
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bmp.h"
+
+// Default limit, in MiB, on pixel data a filter may hold in memory before it works out of core
+#ifndef MEMORY_BUDGET_MB
+#define MEMORY_BUDGET_MB 256
+#endif
+
+/**
+ * MAPPEDBMP
+ *
+ * An infile's pixel array, mapped read-only. Scanlines are in file order and
+ * stride bytes apart, padding included.
+ */
+typedef struct
+{
+    BYTE    *base;
+    size_t   length;
+    BYTE    *pixels;
+    size_t   stride;
+    int      height;
+    int      width;
+}
+MAPPEDBMP;
+
+// Bytes of pixel data allowed in memory, overridable with the FILTER_MEMORY_MB environment variable
+size_t memory_budget(void);
+
+// Bytes per scanline of an image width pixels wide, padding included
+size_t scanline_size(int width);
+
+// Map infile's pixel array; returns 0 on success
+int map_bmp(FILE *inptr, BITMAPFILEHEADER bf, BITMAPINFOHEADER bi, MAPPEDBMP *bmp);
+
+// Unmap infile's pixel array
+void unmap_bmp(MAPPEDBMP *bmp);
+
+// Map an unlinked scratch file of size bytes read-write; returns NULL on failure
+BYTE *map_scratch(size_t size);
+
+// Unmap a scratch file, discarding it
+void unmap_scratch(BYTE *scratch, size_t size);
+
+// Drop the pages of a mapping covering [start, start + length) from resident memory
+void release_range(const void *start, size_t length);
+
+#endif